@@ -0,0 +1,281 @@
+#pragma once
+#include "operation.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace core
+{
+	using namespace std;
+
+	/// @brief Moves data between neighbouring data-parallel workers arranged in a ring.
+	/// Rank r sends to rank (r + 1) % world_size and receives from rank (r - 1) % world_size.
+	class Transport
+	{
+	public:
+		virtual ~Transport() = default;
+
+		[[nodiscard]] virtual size_t rank() const = 0;
+		[[nodiscard]] virtual size_t world_size() const = 0;
+
+		/// @brief Sends `count` elements to the next rank while receiving `count` elements from the previous rank.
+		/// Both directions are done together so every rank can call it at once without deadlocking.
+		virtual void exchange(const simd<float>* to_next, simd<float>* from_previous, size_t count) = 0;
+	};
+
+	/// @brief Sums `count` elements in-place across all ranks, using a ring reduce-scatter followed by a ring all-gather.
+	/// `count` must be a multiple of the world size, so that each rank owns an equal segment.
+	inline void ring_all_reduce(Transport& transport, simd<float>* data, size_t count)
+	{
+		const size_t world_size = transport.world_size();
+		const size_t rank = transport.rank();
+
+		if (world_size == 1) {
+			return;
+		}
+		if (count % world_size != 0) {
+			throw std::invalid_argument("All-reduce element count must be a multiple of the world size.");
+		}
+
+		const size_t segment_size = count / world_size;
+		vector<simd<float>> received(segment_size);
+
+		auto segment = [&](size_t index) { return data + (index % world_size) * segment_size; };
+
+		// Reduce-scatter: after world_size - 1 steps, rank r holds the full sum of segment (r + 1) % world_size
+		for (size_t step = 0; step < world_size - 1; ++step)
+		{
+			transport.exchange(segment(rank + world_size - step), received.data(), segment_size);
+
+			simd<float>* target = segment(rank + world_size - step - 1);
+			for (size_t i = 0; i < segment_size; ++i) {
+				target[i] += received[i];
+			}
+		}
+
+		// All-gather: pass the fully reduced segments around the ring
+		for (size_t step = 0; step < world_size - 1; ++step)
+		{
+			transport.exchange(segment(rank + world_size + 1 - step), segment(rank + world_size - step), segment_size);
+		}
+	}
+
+	/// @brief Averages parameter gradients across data-parallel workers.
+	/// Gradients are grouped into buckets, and each bucket is all-reduced on a background thread
+	/// as soon as all of its parameters are marked ready, overlapping with the rest of the backward pass.
+	class GradientAllReducer
+	{
+	public:
+		/// @param bucket_capacity Target bucket size in simd<float> elements. A parameter larger than this gets a bucket of its own.
+		GradientAllReducer(Transport& transport, vector<shared_ptr<TensorWithGradient>> parameters, size_t bucket_capacity = 64 * 1024)
+			: transport(transport), parameters(std::move(parameters)), bucket_of(this->parameters.size())
+		{
+			// Backward produces gradients from the last parameter to the first, so buckets are filled in that order
+			for (size_t i = this->parameters.size(); i-- > 0;)
+			{
+				const size_t size = this->parameters[i]->gradient.data().size();
+
+				if (buckets.empty() || (buckets.back().size > 0 && buckets.back().size + size > bucket_capacity)) {
+					buckets.emplace_back();
+				}
+
+				buckets.back().parameters.push_back(i);
+				buckets.back().size += size;
+				bucket_of[i] = buckets.size() - 1;
+			}
+
+			reset();
+		}
+
+		GradientAllReducer(const GradientAllReducer&) = delete;
+		GradientAllReducer& operator=(const GradientAllReducer&) = delete;
+
+		// Stops a worker still waiting on buckets, e.g. when backward threw before every parameter was marked ready
+		~GradientAllReducer()
+		{
+			{
+				lock_guard lock(mutex);
+				stopping = true;
+			}
+			ready.notify_all();
+
+			if (worker.joinable()) {
+				worker.join();
+			}
+		}
+
+		/// @brief Marks the gradient of a parameter as final for this iteration. Safe to call from any thread.
+		void mark_ready(size_t parameter_index)
+		{
+			{
+				lock_guard lock(mutex);
+
+				if (parameter_index >= parameters.size()) {
+					throw std::out_of_range("Parameter index " + std::to_string(parameter_index) + " is out of range.");
+				}
+				if (marked[parameter_index]) {
+					throw std::logic_error("Parameter " + std::to_string(parameter_index) + " was already marked ready this iteration.");
+				}
+				marked[parameter_index] = true;
+
+				if (--pending[bucket_of[parameter_index]] == 0) {
+					ready.notify_all();
+				}
+
+				if (!worker.joinable()) {
+					start_worker();
+				}
+			}
+		}
+
+		/// @brief Blocks until every bucket has been reduced, leaving averaged gradients in place.
+		/// Throws std::logic_error and abandons the iteration if any parameter was not marked ready, e.g. one unused by this forward pass.
+		void wait()
+		{
+			{
+				unique_lock lock(mutex);
+
+				const auto unmarked = std::find(marked.begin(), marked.end(), false);
+				if (unmarked != marked.end())
+				{
+					const size_t parameter_index = unmarked - marked.begin();
+					stopping = true;
+					lock.unlock();
+					ready.notify_all();
+
+					if (worker.joinable()) {
+						worker.join();
+					}
+
+					lock.lock();
+					stopping = false;
+					reset();
+					failure = nullptr;
+					throw std::logic_error("Parameter " + std::to_string(parameter_index) + " was not marked ready before wait().");
+				}
+
+				if (!worker.joinable()) {
+					start_worker();
+				}
+			}
+
+			worker.join();
+			reset();
+
+			if (failure) {
+				rethrow_exception(std::exchange(failure, nullptr));
+			}
+		}
+
+		[[nodiscard]] size_t bucket_count() const
+		{
+			return buckets.size();
+		}
+
+		/// @brief Number of buckets already averaged in the current iteration, or in the last one once wait() has returned.
+		/// Their gradients can be used while later buckets are still in flight.
+		[[nodiscard]] size_t reduced_bucket_count() const
+		{
+			return reduced.load(std::memory_order_acquire);
+		}
+
+	private:
+
+		struct Bucket
+		{
+			vector<size_t> parameters;
+			size_t size = 0;
+		};
+
+		void reset()
+		{
+			pending.clear();
+			for (const auto& bucket : buckets) {
+				pending.push_back(bucket.parameters.size());
+			}
+			marked.assign(parameters.size(), false);
+		}
+
+		// Called under the mutex at the start of each iteration
+		void start_worker()
+		{
+			reduced.store(0, std::memory_order_relaxed);
+			worker = std::thread(&GradientAllReducer::reduce_buckets, this);
+		}
+
+		// Buckets are always reduced in index order, so every rank issues the same sequence of collectives
+		void reduce_buckets()
+		{
+			const size_t world_size = transport.world_size();
+			const simd<float> scale{ 1.0f / world_size };
+
+			try
+			{
+				for (size_t b = 0; b < buckets.size(); ++b)
+				{
+					{
+						unique_lock lock(mutex);
+						ready.wait(lock, [&] { return pending[b] == 0 || stopping; });
+
+						if (stopping) {
+							return;
+						}
+					}
+
+					const Bucket& bucket = buckets[b];
+
+					// Pad so the bucket splits evenly into one segment per rank
+					staging.assign(((bucket.size + world_size - 1) / world_size) * world_size, simd<float>::zero());
+
+					simd<float>* out = staging.data();
+					for (size_t p : bucket.parameters)
+					{
+						const auto gradient = parameters[p]->gradient.data();
+						out = std::copy(gradient.data_handle(), gradient.data_handle() + gradient.size(), out);
+					}
+
+					ring_all_reduce(transport, staging.data(), staging.size());
+
+					const simd<float>* in = staging.data();
+					for (size_t p : bucket.parameters)
+					{
+						auto gradient = parameters[p]->gradient.data();
+						for (size_t i = 0; i < gradient.size(); ++i) {
+							gradient.data_handle()[i] = in[i] * scale;
+						}
+						in += gradient.size();
+					}
+
+					reduced.store(b + 1, std::memory_order_release);
+				}
+			}
+			catch (...)
+			{
+				failure = current_exception();
+			}
+		}
+
+		Transport& transport;
+		vector<shared_ptr<TensorWithGradient>> parameters;
+		vector<size_t> bucket_of;
+		vector<Bucket> buckets;
+		vector<size_t> pending;
+		vector<bool> marked;
+		vector<simd<float>> staging;
+
+		std::mutex mutex;
+		std::condition_variable ready;
+		std::thread worker;
+		exception_ptr failure;
+		bool stopping = false;
+		std::atomic<size_t> reduced{ 0 };
+	};
+}
@@ -0,0 +1,215 @@
+#pragma once
+#include "core/tensor.h"
+#include <immintrin.h>
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // Outputs at least this large are written with non-temporal stores, as they would only evict the embedding table from cache
+    constexpr size_t embedding_non_temporal_bytes = 4 * 1024 * 1024;
+
+    // How many ids ahead of the current row to prefetch
+    constexpr size_t embedding_prefetch_distance = 4;
+
+    constexpr size_t embedding_cache_line_bytes = 64;
+
+    /// @brief Prefetches every cache line of a row `width` simd elements wide, since a gathered row is rarely next to the previous one
+    template<typename T>
+    void prefetch_row(const simd<T>* row, size_t width)
+    {
+        constexpr size_t step = std::max<size_t>(embedding_cache_line_bytes / sizeof(simd<T>), 1);
+        for (size_t x = 0; x < width; x += step) {
+            _mm_prefetch(reinterpret_cast<const char*>(row + x), _MM_HINT_T0);
+        }
+    }
+
+    template<typename T>
+    void check_embedding_ids(const Tensor<T>& table, std::span<const int> ids)
+    {
+        for (int id : ids) {
+            if (id < 0 || id >= table.shape(-2)) {
+                throw std::out_of_range("Embedding id " + std::to_string(id) + " is outside the table.");
+            }
+        }
+    }
+
+    /// @brief Returns the positions of `ids` ordered by id, so that repeated ids form contiguous segments
+    std::vector<uint32_t> sort_by_id(std::span<const int> ids)
+    {
+        std::vector<uint32_t> order(ids.size());
+        std::iota(order.begin(), order.end(), 0u);
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return ids[a] < ids[b]; });
+        return order;
+    }
+
+    /// @brief Returns the start of each run of equal ids in `order`, followed by `order.size()`
+    std::vector<size_t> segment_starts(std::span<const int> ids, const std::vector<uint32_t>& order)
+    {
+        std::vector<size_t> starts;
+        for (size_t i = 0; i < order.size(); ++i) {
+            if (i == 0 || ids[order[i]] != ids[order[i - 1]]) {
+                starts.push_back(i);
+            }
+        }
+        starts.push_back(order.size());
+        return starts;
+    }
+
+    /// @brief Sums the rows of `source` listed in `order[begin, end)` into `destination`, a row `width` simd elements wide
+    template<typename T>
+    void reduce_segment(simd<T>* destination, const simd<T>* source, size_t width, const std::vector<uint32_t>& order, size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            if (i + embedding_prefetch_distance < end) {
+                prefetch_row(source + order[i + embedding_prefetch_distance] * width, width);
+            }
+
+            const simd<T>* row = source + order[i] * width;
+            for (size_t x = 0; x < width; ++x) {
+                destination[x] += row[x];
+            }
+        }
+    }
+}
+
+/// @brief Sparse gradient of an embedding table. Holds one summed row per distinct id, so an optimizer only needs to touch the rows that were hit.
+template<typename T>
+struct SparseRowGradient
+{
+    std::vector<int> rows;  // Distinct ids in increasing order
+    Tensor<T> values;       // [rows.size(), width] summed gradients, one row per id
+};
+
+// Gathers the embedding rows for each id. The result has one row per id: [ids.size(), table.shape(-1)]
+template<typename T>
+Tensor<T> embedding_lookup(const Tensor<T>& table, std::span<const int> ids)
+{
+    check_embedding_ids(table, ids);
+
+    const size_t width = table.shape(-1);
+    Tensor<T> result(Extents{ static_cast<int>(ids.size()), table.shape(-1) });
+
+    const simd<T>* source = table.data().data_handle();
+    simd<T>* destination = result.data().data_handle();
+
+    const bool non_temporal = ids.size() * width * sizeof(simd<T>) >= embedding_non_temporal_bytes;
+
+    for (size_t i = 0; i < ids.size(); ++i)
+    {
+        if (i + embedding_prefetch_distance < ids.size()) {
+            prefetch_row(source + ids[i + embedding_prefetch_distance] * width, width);
+        }
+
+        const simd<T>* row = source + ids[i] * width;
+        simd<T>* out = destination + i * width;
+
+        if (non_temporal) {
+            for (size_t x = 0; x < width; ++x) {
+                _mm256_stream_ps(reinterpret_cast<float*>(out + x), row[x].get());
+            }
+        }
+        else {
+            std::copy(row, row + width, out);
+        }
+    }
+
+    if (non_temporal) {
+        _mm_sfence();
+    }
+
+    return result;
+}
+
+// Backward of embedding_lookup: adds each row of outputGradient into gradientTable at its id.
+// Positions are sorted by id and each run of repeated ids is reduced once, so every table row is owned by exactly one thread and no locking is needed.
+template<typename T>
+void embedding_scatter_add(Tensor<T>& gradientTable, std::span<const int> ids, const Tensor<T>& outputGradient, size_t threads = 1)
+{
+    if (outputGradient.shape(-2) != static_cast<int>(ids.size()) || outputGradient.shape(-1) != gradientTable.shape(-1)) {
+        throw std::invalid_argument("Output gradient must have one row per id, matching the embedding width.");
+    }
+    check_embedding_ids(gradientTable, ids);
+
+    const size_t width = gradientTable.shape(-1);
+    const auto order = sort_by_id(ids);
+    const auto starts = segment_starts(ids, order);
+    const size_t segments = starts.size() - 1;
+
+    const simd<T>* source = outputGradient.data().data_handle();
+    simd<T>* destination = gradientTable.data().data_handle();
+
+    auto reduce_segments = [&](size_t first, size_t last) {
+        for (size_t s = first; s < last; ++s) {
+            reduce_segment(destination + ids[order[starts[s]]] * width, source, width, order, starts[s], starts[s + 1]);
+        }
+    };
+
+    threads = std::clamp<size_t>(threads, 1, std::max<size_t>(segments, 1));
+    if (threads == 1) {
+        reduce_segments(0, segments);
+        return;
+    }
+
+    std::vector<std::jthread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back(reduce_segments, segments * t / threads, segments * (t + 1) / threads);
+    }
+}
+
+// Backward of embedding_lookup as a sparse gradient, with one summed row per distinct id
+template<typename T>
+SparseRowGradient<T> embedding_gradient_sparse(std::span<const int> ids, const Tensor<T>& outputGradient)
+{
+    if (outputGradient.shape(-2) != static_cast<int>(ids.size())) {
+        throw std::invalid_argument("Output gradient must have one row per id.");
+    }
+
+    const size_t width = outputGradient.shape(-1);
+    const auto order = sort_by_id(ids);
+    const auto starts = segment_starts(ids, order);
+    const size_t segments = starts.size() - 1;
+
+    SparseRowGradient<T> gradient{ {}, Tensor<T>(Extents{ static_cast<int>(segments), outputGradient.shape(-1) }) };
+    gradient.rows.reserve(segments);
+
+    const simd<T>* source = outputGradient.data().data_handle();
+    simd<T>* destination = gradient.values.data().data_handle();
+
+    for (size_t s = 0; s < segments; ++s)
+    {
+        gradient.rows.push_back(ids[order[starts[s]]]);
+        reduce_segment(destination + s * width, source, width, order, starts[s], starts[s + 1]);
+    }
+
+    return gradient;
+}
+
+// Plain SGD step that only updates the table rows present in the sparse gradient
+template<typename T>
+void apply_sparse_gradient(Tensor<T>& table, const SparseRowGradient<T>& gradient, T learningRate)
+{
+    if (gradient.values.shape(-1) != table.shape(-1)) {
+        throw std::invalid_argument("Sparse gradient width must match the embedding table.");
+    }
+    check_embedding_ids(table, gradient.rows);
+
+    const size_t width = table.shape(-1);
+    const simd<T> rate{ learningRate };
+
+    for (size_t r = 0; r < gradient.rows.size(); ++r)
+    {
+        simd<T>* row = table.data().data_handle() + gradient.rows[r] * width;
+        const simd<T>* delta = gradient.values.data().data_handle() + r * width;
+
+        for (size_t x = 0; x < width; ++x) {
+            row[x] -= delta[x] * rate;
+        }
+    }
+}
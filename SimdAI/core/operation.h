@@ -1,5 +1,6 @@
 #pragma once
 #include "tensor.h"
+#include <memory>
 #include <vector>
 
 namespace core
@@ -16,19 +17,19 @@ namespace core
 	class Operation
 	{
 		virtual vector<shared_ptr<TensorWithGradient>> forward(const vector<shared_ptr<TensorWithGradient>>& input) = 0;
-		virtual vector<shared_ptr<TensorWithGradient>> backward(const vector<TensorWithGradient>& gradient) = 0;
+		virtual vector<shared_ptr<TensorWithGradient>> backward(const vector<shared_ptr<TensorWithGradient>>& gradient) = 0;
 	};
 
 	class MatmulOperation : Operation
 	{
-		vector<shared_ptr<TensorWithGradient>> forward(const vector<shared_ptr<TensorWithGradient>>& input) override
+		vector<shared_ptr<TensorWithGradient>> forward(const vector<shared_ptr<TensorWithGradient>>& /*input*/) override
 		{
-
+			return {};
 		}
 
-		vector<shared_ptr<TensorWithGradient>> backward(const vector<shared_ptr<TensorWithGradient>>& gradient) override
+		vector<shared_ptr<TensorWithGradient>> backward(const vector<shared_ptr<TensorWithGradient>>& /*gradient*/) override
 		{
-
+			return {};
 		}
 	};
 }
\ No newline at end of file
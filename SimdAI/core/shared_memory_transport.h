@@ -0,0 +1,297 @@
+#pragma once
+#include "all_reduce.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace core
+{
+	using namespace std;
+
+	/// @brief Ring transport between worker processes on one machine, backed by a POSIX shared memory segment (Linux only).
+	/// Each rank owns a single-slot mailbox that its successor drains. Every rank must construct it with the same name,
+	/// world size and capacity. Rank 0 replaces any segment left over from an earlier run, and construction returns once
+	/// every rank has joined. Waits for peers throw std::runtime_error after `timeout`, so a dead worker can't hang the others.
+	class SharedMemoryTransport : public Transport
+	{
+	public:
+		/// @param capacity Mailbox size in simd<float> elements. Larger exchanges are split into pieces of this size.
+		SharedMemoryTransport(string name, size_t rank, size_t world_size, size_t capacity = 16 * 1024, chrono::milliseconds timeout = chrono::seconds(30))
+			: name(std::move(name)), current_rank(rank), ranks(world_size), capacity(capacity), timeout(timeout),
+			  header_bytes(header_size(world_size)), mailbox_bytes(mailbox_size(capacity))
+		{
+			if (world_size == 0 || rank >= world_size || capacity == 0) {
+				throw std::invalid_argument("Invalid shared memory transport configuration.");
+			}
+
+			// The destructor doesn't run if construction fails, so release the mapping and segment here
+			try
+			{
+				if (rank == 0) {
+					create();
+				}
+				else {
+					join();
+				}
+			}
+			catch (...)
+			{
+				unmap();
+				if (rank == 0) {
+					shm_unlink(this->name.c_str());
+				}
+				throw;
+			}
+		}
+
+		SharedMemoryTransport(const SharedMemoryTransport&) = delete;
+		SharedMemoryTransport& operator=(const SharedMemoryTransport&) = delete;
+
+		~SharedMemoryTransport() override
+		{
+			unmap();
+
+			if (current_rank == 0) {
+				shm_unlink(name.c_str());
+			}
+		}
+
+		/// @brief Size in bytes of the shared memory segment used for a given world size and mailbox capacity.
+		[[nodiscard]] static size_t segment_size(size_t world_size, size_t capacity)
+		{
+			return header_size(world_size) + mailbox_size(capacity) * world_size;
+		}
+
+		/// @brief Removes a segment left behind by a previous run that did not shut down cleanly.
+		static void remove(const string& name)
+		{
+			shm_unlink(name.c_str());
+		}
+
+		[[nodiscard]] size_t rank() const override
+		{
+			return current_rank;
+		}
+
+		[[nodiscard]] size_t world_size() const override
+		{
+			return ranks;
+		}
+
+		void exchange(const simd<float>* to_next, simd<float>* from_previous, size_t count) override
+		{
+			Mailbox& outgoing = mailbox(current_rank);
+			Mailbox& incoming = mailbox((current_rank + ranks - 1) % ranks);
+
+			for (size_t offset = 0; offset < count; offset += capacity)
+			{
+				const size_t piece = std::min(capacity, count - offset);
+
+				// Post our piece once the successor has drained the previous one
+				wait_for(outgoing.full, 0u);
+				float* out = outgoing.payload();
+				for (size_t i = 0; i < piece; ++i) {
+					to_next[offset + i].copy_to(out + i * simd<float>::size());
+				}
+				atomic_ref(outgoing.full).store(1, std::memory_order_release);
+
+				// Then take the matching piece from the predecessor
+				wait_for(incoming.full, 1u);
+				const float* in = incoming.payload();
+				for (size_t i = 0; i < piece; ++i) {
+					from_previous[offset + i] = simd<float>::copy_from(in + i * simd<float>::size());
+				}
+				atomic_ref(incoming.full).store(0, std::memory_order_release);
+			}
+		}
+
+	private:
+
+		// The flags below live in shared memory as plain integers and are only ever accessed through std::atomic_ref
+
+		struct alignas(64) Header
+		{
+			uint32_t initialized;
+		};
+
+		// Joining ranks post a fresh nonce, which only a live rank 0 on the current segment can acknowledge
+		struct Rendezvous
+		{
+			uint64_t join;
+			uint64_t acknowledged;
+		};
+
+		struct alignas(64) Mailbox
+		{
+			uint32_t full;
+
+			float* payload()
+			{
+				return reinterpret_cast<float*>(this + 1);
+			}
+		};
+		static_assert(std::atomic_ref<uint32_t>::is_always_lock_free && std::atomic_ref<uint64_t>::is_always_lock_free,
+			"Shared flags must be lock-free to be shared between processes.");
+
+		using Clock = chrono::steady_clock;
+
+		// Both regions are rounded up to a cache line, which keeps every Mailbox 64-byte aligned
+		static size_t header_size(size_t world_size)
+		{
+			return ((sizeof(Header) + world_size * sizeof(Rendezvous) + 63) / 64) * 64;
+		}
+
+		static size_t mailbox_size(size_t capacity)
+		{
+			return ((sizeof(Mailbox) + capacity * sizeof(simd<float>) + 63) / 64) * 64;
+		}
+
+		[[nodiscard]] size_t segment_bytes() const
+		{
+			return header_bytes + mailbox_bytes * ranks;
+		}
+
+		Header& header()
+		{
+			return *reinterpret_cast<Header*>(memory);
+		}
+
+		Rendezvous& rendezvous(size_t index)
+		{
+			return reinterpret_cast<Rendezvous*>(memory + sizeof(Header))[index];
+		}
+
+		Mailbox& mailbox(size_t index)
+		{
+			return *reinterpret_cast<Mailbox*>(memory + header_bytes + index * mailbox_bytes);
+		}
+
+		// Rank 0 always starts from a freshly created, zero-filled segment
+		void create()
+		{
+			shm_unlink(name.c_str());
+
+			const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+			if (fd < 0) {
+				throw std::system_error(errno, std::generic_category(), "shm_open");
+			}
+			if (ftruncate(fd, segment_bytes()) != 0) {
+				const int error = errno;
+				close(fd);
+				throw std::system_error(error, std::generic_category(), "ftruncate");
+			}
+			map(fd);
+
+			atomic_ref(header().initialized).store(1, std::memory_order_release);
+
+			const auto deadline = Clock::now() + timeout;
+			for (size_t r = 1; r < ranks; ++r)
+			{
+				uint64_t& join = rendezvous(r).join;
+				wait_until(deadline, [&] { return atomic_ref(join).load(std::memory_order_acquire) != 0; });
+				atomic_ref(rendezvous(r).acknowledged).store(atomic_ref(join).load(std::memory_order_relaxed), std::memory_order_release);
+			}
+		}
+
+		// Other ranks retry until rank 0 acknowledges them, which a stale segment never does
+		void join()
+		{
+			const uint64_t nonce = ((uint64_t(getpid()) << 32) ^ uint64_t(Clock::now().time_since_epoch().count())) | 1;
+			const auto deadline = Clock::now() + timeout;
+
+			wait_until(deadline, [&] {
+				unmap();
+
+				const int fd = shm_open(name.c_str(), O_RDWR, 0600);
+				if (fd < 0) {
+					return false;
+				}
+
+				struct stat status{};
+				if (fstat(fd, &status) != 0 || size_t(status.st_size) != segment_bytes()) {
+					close(fd);
+					return false;
+				}
+				map(fd);
+
+				if (atomic_ref(header().initialized).load(std::memory_order_acquire) != 1) {
+					return false;
+				}
+
+				Rendezvous& slot = rendezvous(current_rank);
+				atomic_ref(slot.join).store(nonce, std::memory_order_release);
+
+				// Give rank 0 a moment to acknowledge before checking whether the segment was replaced
+				const auto retry = std::min(deadline, Clock::now() + chrono::milliseconds(50));
+				while (Clock::now() < retry) {
+					if (atomic_ref(slot.acknowledged).load(std::memory_order_acquire) == nonce) {
+						return true;
+					}
+					std::this_thread::yield();
+				}
+				return false;
+			});
+		}
+
+		void map(int fd)
+		{
+			void* mapped = mmap(nullptr, segment_bytes(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			const int error = errno;
+			close(fd);
+
+			if (mapped == MAP_FAILED) {
+				throw std::system_error(error, std::generic_category(), "mmap");
+			}
+			memory = static_cast<std::byte*>(mapped);
+		}
+
+		void unmap()
+		{
+			if (memory) {
+				munmap(memory, segment_bytes());
+				memory = nullptr;
+			}
+		}
+
+		template<class Condition>
+		void wait_until(Clock::time_point deadline, Condition condition) const
+		{
+			for (size_t spins = 0; !condition(); ++spins)
+			{
+				if (spins < 1024) {
+					_mm_pause();
+					continue;
+				}
+				if (Clock::now() >= deadline) {
+					throw std::runtime_error("Timed out waiting for a peer on shared memory segment " + name + ".");
+				}
+				std::this_thread::yield();
+			}
+		}
+
+		void wait_for(uint32_t& flag, uint32_t value) const
+		{
+			wait_until(Clock::now() + timeout, [&] { return atomic_ref(flag).load(std::memory_order_acquire) == value; });
+		}
+
+		string name;
+		size_t current_rank;
+		size_t ranks;
+		size_t capacity;
+		chrono::milliseconds timeout;
+		size_t header_bytes;
+		size_t mailbox_bytes;
+		std::byte* memory = nullptr;
+	};
+}
@@ -0,0 +1,267 @@
+#include "catch2/catch.hpp"
+#include "core/all_reduce.h"
+
+#ifdef __linux__
+#include "core/shared_memory_transport.h"
+#include <sys/wait.h>
+#endif
+
+using namespace core;
+
+namespace
+{
+	// Single worker transport, for exercising the reducer without other processes
+	class LocalTransport : public Transport
+	{
+	public:
+		size_t rank() const override { return 0; }
+		size_t world_size() const override { return 1; }
+		void exchange(const simd<float>*, simd<float>*, size_t) override {}
+	};
+
+	std::vector<std::shared_ptr<TensorWithGradient>> make_parameters(std::initializer_list<int> rows)
+	{
+		std::vector<std::shared_ptr<TensorWithGradient>> parameters;
+		for (int count : rows) {
+			parameters.push_back(std::make_shared<TensorWithGradient>(TensorWithGradient{ Tensor<float>(Extents{ count, 1 }), Tensor<float>(Extents{ count, 1 }) }));
+		}
+		return parameters;
+	}
+}
+
+TEST_CASE("Gradient all-reducer rejects invalid ready marks", "[all_reduce]")
+{
+	LocalTransport transport;
+	GradientAllReducer reducer(transport, make_parameters({ 1, 1 }), 1);
+
+	CHECK_THROWS_AS(reducer.mark_ready(2), std::out_of_range);
+
+	reducer.mark_ready(1);
+	CHECK_THROWS_AS(reducer.mark_ready(1), std::logic_error);
+
+	reducer.mark_ready(0);
+	reducer.wait();
+
+	// Marks reset after each iteration
+	reducer.mark_ready(1);
+	reducer.mark_ready(0);
+	reducer.wait();
+}
+
+TEST_CASE("Gradient all-reducer rejects waiting on unmarked parameters", "[all_reduce]")
+{
+	LocalTransport transport;
+	GradientAllReducer reducer(transport, make_parameters({ 1, 1 }), 1);
+
+	reducer.mark_ready(1);
+	CHECK_THROWS_AS(reducer.wait(), std::logic_error);
+
+	// The abandoned iteration leaves the reducer ready for the next one
+	reducer.mark_ready(1);
+	reducer.mark_ready(0);
+	reducer.wait();
+	CHECK(reducer.reduced_bucket_count() == 2);
+}
+
+TEST_CASE("Gradient all-reducer shuts down with buckets still pending", "[all_reduce]")
+{
+	LocalTransport transport;
+	{
+		GradientAllReducer reducer(transport, make_parameters({ 1, 1 }), 1);
+		reducer.mark_ready(1);
+	}
+	SUCCEED("Destructor returned without every parameter marked ready");
+}
+
+#ifdef __linux__
+namespace
+{
+	// Runs `worker(rank)` in `world_size` forked processes and returns how many of them reported success
+	template<class Worker>
+	size_t run_workers(size_t world_size, Worker worker)
+	{
+		std::vector<pid_t> children;
+		for (size_t rank = 0; rank < world_size; ++rank)
+		{
+			const pid_t pid = fork();
+			if (pid == 0) {
+				bool passed = false;
+				try {
+					passed = worker(rank);
+				}
+				catch (...) {
+				}
+				_exit(passed ? 0 : 1);
+			}
+			children.push_back(pid);
+		}
+
+		size_t passed = 0;
+		for (pid_t pid : children)
+		{
+			int status = 0;
+			waitpid(pid, &status, 0);
+			passed += WIFEXITED(status) && WEXITSTATUS(status) == 0;
+		}
+		return passed;
+	}
+
+	std::string segment_name(const char* test)
+	{
+		return "/simdai_" + std::string(test) + "_" + std::to_string(getpid());
+	}
+}
+
+TEST_CASE("Ring all-reduce over shared memory", "[all_reduce]")
+{
+	constexpr size_t world_size = 4;
+	const std::string name = segment_name("ring");
+
+	// Leave behind a segment as a crashed run would: the right size, marked initialized, with stale rendezvous slots and every mailbox full
+	{
+		const int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0600);
+		REQUIRE(fd >= 0);
+		const std::vector<uint32_t> stale(SharedMemoryTransport::segment_size(world_size, 3) / sizeof(uint32_t), 1);
+		REQUIRE(write(fd, stale.data(), stale.size() * sizeof(uint32_t)) == ssize_t(stale.size() * sizeof(uint32_t)));
+		close(fd);
+	}
+
+	// A small mailbox forces each exchange to be split into several pieces
+	const size_t passed = run_workers(world_size, [&](size_t rank) {
+		// Delay rank 0 so the other ranks attach to the stale segment first, and have to be turned away by the missing acknowledgement
+		if (rank == 0) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(200));
+		}
+		SharedMemoryTransport transport(name, rank, world_size, 3, std::chrono::seconds(5));
+
+		std::vector<simd<float>> data;
+		for (size_t i = 0; i < 40; ++i) {
+			data.push_back(simd<float>{ float(rank * 100 + i) });
+		}
+
+		ring_all_reduce(transport, data.data(), data.size());
+
+		for (size_t i = 0; i < data.size(); ++i) {
+			if (data[i] != simd<float>{ float(600 + 4 * i) }) {
+				return false;
+			}
+		}
+		return true;
+	});
+
+	CHECK(passed == world_size);
+}
+
+TEST_CASE("Bucketed gradient averaging across processes", "[all_reduce]")
+{
+	constexpr size_t world_size = 3;
+	const std::string name = segment_name("buckets");
+
+	const size_t passed = run_workers(world_size, [&](size_t rank) {
+		SharedMemoryTransport transport(name, rank, world_size, 8, std::chrono::seconds(5));
+
+		std::vector<std::shared_ptr<TensorWithGradient>> parameters;
+		for (int rows : { 1, 5, 2, 7 })
+		{
+			auto parameter = std::make_shared<TensorWithGradient>(TensorWithGradient{ Tensor<float>(Extents{ rows, 2 }), Tensor<float>(Extents{ rows, 2 }) });
+			for (int row = 0; row < rows; ++row) {
+				parameter->gradient[row, 0] = simd<float>{ float(rank) };
+				parameter->gradient[row, 1] = simd<float>{ float(rank * row) };
+			}
+			parameters.push_back(parameter);
+		}
+
+		GradientAllReducer reducer(transport, parameters, 12);
+
+		// Buckets in backward order are { 3 }, { 2 }, { 1, 0 }
+		if (reducer.bucket_count() != 3) {
+			return false;
+		}
+
+		// First iteration: bucket 0 must be averaged while the rest of backward has not produced its gradients yet
+		reducer.mark_ready(3);
+
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+		while (reducer.reduced_bucket_count() < 1) {
+			if (std::chrono::steady_clock::now() > deadline) {
+				return false;
+			}
+			std::this_thread::yield();
+		}
+
+		for (int row = 0; row < 7; ++row) {
+			if (parameters[3]->gradient[row, 0] != simd<float>{ 1.0f } || parameters[3]->gradient[row, 1] != simd<float>{ float(row) }) {
+				return false;
+			}
+		}
+		if (reducer.reduced_bucket_count() != 1 || parameters[0]->gradient[0, 0] != simd<float>{ float(rank) }) {
+			return false;
+		}
+
+		std::thread backward([&] {
+			for (size_t i = 3; i-- > 0;) {
+				reducer.mark_ready(i);
+			}
+		});
+		backward.join();
+		reducer.wait();
+
+		// Second iteration, marking every gradient up front
+		for (size_t i = parameters.size(); i-- > 0;) {
+			reducer.mark_ready(i);
+		}
+		reducer.wait();
+
+		// Mean over ranks 0..2 is 1, and the second iteration averages already averaged values
+		for (const auto& parameter : parameters)
+		{
+			for (int row = 0; row < parameter->gradient.shape(0); ++row) {
+				if (parameter->gradient[row, 0] != simd<float>{ 1.0f } || parameter->gradient[row, 1] != simd<float>{ float(row) }) {
+					return false;
+				}
+			}
+		}
+		return true;
+	});
+
+	CHECK(passed == world_size);
+}
+
+TEST_CASE("Shared memory transport removes its segment when no peer joins", "[all_reduce]")
+{
+	const std::string name = segment_name("no_peer");
+
+	CHECK_THROWS_AS(SharedMemoryTransport(name, 0, 2, 8, std::chrono::milliseconds(100)), std::runtime_error);
+
+	const int fd = shm_open(name.c_str(), O_RDWR, 0600);
+	CHECK(fd < 0);
+	if (fd >= 0) {
+		close(fd);
+		SharedMemoryTransport::remove(name);
+	}
+}
+
+TEST_CASE("Shared memory transport times out on a dead peer", "[all_reduce]")
+{
+	constexpr size_t world_size = 2;
+	const std::string name = segment_name("dead_peer");
+
+	const size_t passed = run_workers(world_size, [&](size_t rank) {
+		SharedMemoryTransport transport(name, rank, world_size, 8, std::chrono::milliseconds(200));
+		if (rank == 1) {
+			return true; // Exits without taking part in the all-reduce
+		}
+
+		std::vector<simd<float>> data(8);
+		try {
+			ring_all_reduce(transport, data.data(), data.size());
+		}
+		catch (const std::runtime_error&) {
+			return true;
+		}
+		return false;
+	});
+
+	CHECK(passed == world_size);
+}
+#endif
@@ -0,0 +1,111 @@
+#include "catch2/catch.hpp"
+#include "core/embedding.h"
+
+TEST_CASE("Embedding lookup gathers rows by id", "[embedding]") {
+	Tensor<float> table = {
+		{ simd<float>{0.0f}, simd<float>{10} },
+		{ simd<float>{1}, simd<float>{11} },
+		{ simd<float>{2}, simd<float>{12} }
+	};
+	std::vector<int> ids = { 2, 0, 2, 1 };
+
+	Tensor<float> result = embedding_lookup(table, std::span<const int>(ids));
+
+	CHECK(result.shape(0) == 4);
+	CHECK(result.shape(1) == 2);
+	for (size_t i = 0; i < ids.size(); ++i) {
+		CHECK(result[i, 0] == table[ids[i], 0]);
+		CHECK(result[i, 1] == table[ids[i], 1]);
+	}
+
+	std::vector<int> invalid = { 0, 9 };
+	CHECK_THROWS_AS(embedding_lookup(table, std::span<const int>(invalid)), std::out_of_range);
+}
+
+TEST_CASE("Embedding lookup with non-temporal stores for large batches", "[embedding]") {
+	constexpr int vocabulary = 64;
+	constexpr int width = 16;
+	constexpr int batch = 8192; // 8192 * 16 * 32 bytes = 4 MiB, enough to take the non-temporal store path
+	static_assert(batch * width * sizeof(simd<float>) >= embedding_non_temporal_bytes);
+
+	Tensor<float> table(Extents{ vocabulary, width });
+	for (int row = 0; row < vocabulary; ++row) {
+		for (int x = 0; x < width; ++x) {
+			table[row, x] = simd<float>{ float(row * width + x) };
+		}
+	}
+
+	std::vector<int> ids(batch);
+	for (int i = 0; i < batch; ++i) {
+		ids[i] = (i * 7) % vocabulary;
+	}
+
+	Tensor<float> result = embedding_lookup(table, std::span<const int>(ids));
+
+	bool matches = true;
+	for (int i = 0; i < batch; ++i) {
+		for (int x = 0; x < width; ++x) {
+			matches &= result[i, x] == table[ids[i], x];
+		}
+	}
+	CHECK(matches);
+}
+
+TEST_CASE("Embedding scatter-add accumulates repeated ids", "[embedding]") {
+	constexpr int vocabulary = 50;
+	constexpr int width = 3;
+	constexpr int batch = 400;
+
+	std::vector<int> ids(batch);
+	Tensor<float> outputGradient(Extents{ batch, width });
+	for (int i = 0; i < batch; ++i) {
+		ids[i] = (i * i) % vocabulary;
+		for (int x = 0; x < width; ++x) {
+			outputGradient[i, x] = simd<float>{ float(x + 1) };
+		}
+	}
+
+	// Reference: scalar accumulation in id order
+	Tensor<float> expected(Extents{ vocabulary, width });
+	for (int i = 0; i < batch; ++i) {
+		for (int x = 0; x < width; ++x) {
+			expected[ids[i], x] += outputGradient[i, x];
+		}
+	}
+
+	for (size_t threads : { 1, 4 }) {
+		Tensor<float> gradientTable(Extents{ vocabulary, width });
+		embedding_scatter_add(gradientTable, std::span<const int>(ids), outputGradient, threads);
+		CHECK(gradientTable == expected);
+	}
+}
+
+TEST_CASE("Sparse embedding gradient only touches hit rows", "[embedding]") {
+	Tensor<float> table(Extents{ 6, 2 });
+	for (int row = 0; row < 6; ++row) {
+		table[row, 0] = simd<float>{ 1 };
+		table[row, 1] = simd<float>{ 1 };
+	}
+
+	std::vector<int> ids = { 4, 1, 4, 4 };
+	Tensor<float> outputGradient(Extents{ 4, 2 });
+	for (int i = 0; i < 4; ++i) {
+		outputGradient[i, 0] = simd<float>{ float(2 * i + 1) };
+		outputGradient[i, 1] = simd<float>{ float(2 * i + 2) };
+	}
+
+	SparseRowGradient<float> gradient = embedding_gradient_sparse(std::span<const int>(ids), outputGradient);
+
+	REQUIRE(gradient.rows == std::vector<int>{ 1, 4 });
+	CHECK(gradient.values[0, 0] == simd<float>{ 3 });
+	CHECK(gradient.values[0, 1] == simd<float>{ 4 });
+	CHECK(gradient.values[1, 0] == simd<float>{ 13 });
+	CHECK(gradient.values[1, 1] == simd<float>{ 16 });
+
+	apply_sparse_gradient(table, gradient, 0.5f);
+
+	CHECK(table[1, 0] == simd<float>{ -0.5f });
+	CHECK(table[4, 1] == simd<float>{ -7 });
+	CHECK(table[0, 0] == simd<float>{ 1 });
+	CHECK(table[5, 1] == simd<float>{ 1 });
+}